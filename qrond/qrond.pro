@@ -72,6 +72,8 @@ PRECOMPILED_HEADER *= \
 
 SOURCES *= \
     sched/qrond.cpp \
+    sched/taskinstancejournal.cpp \
+    sched/taskinstancesindex.cpp \
     wui/webconsole.cpp \
     wui/configuploadhandler.cpp \
     wui/htmlalertitemdelegate.cpp \
@@ -83,6 +85,8 @@ SOURCES *= \
 HEADERS *= \
     qrond_stable.h \
     sched/qrond.h \
+    sched/taskinstancejournal.h \
+    sched/taskinstancesindex.h \
     wui/webconsole.h \
     wui/configuploadhandler.h \
     wui/htmlalertitemdelegate.h \
@@ -83,6 +83,10 @@ void Qrond::startup(QByteArrayList args) {
        _configFilePath = args[++i];
     } else if (i < n-1 && (arg == "--config-repository")) {
        _configRepoPath = args[++i];
+    } else if (i < n-1 && (arg == "--journal-directory")) {
+       _journalDirPath = args[++i];
+    } else if (arg == "--requeue-pending-requests") {
+       _requeuePendingRequests = true;
     } else if (i < n-1 && arg == "--http-auth-realm") {
        _httpAuthRealm = args[++i];
        _httpAuthRealm.replace("\"", "'");
@@ -92,6 +96,22 @@ void Qrond::startup(QByteArrayList args) {
   }
   _webconsole->setConfigPaths(_configFilePath, _configRepoPath);
   _httpAuthHandler->setRealm(_httpAuthRealm);
+  if (!_journalDirPath.isEmpty()) {
+    // must be done before loading config to record first events, and before
+    // listening for the journal to be set before any http request
+    _journal = new TaskInstanceJournal(_journalDirPath);
+    if (_journal->open()) {
+      connect(_scheduler, &Scheduler::itemChanged,
+              _journal, &TaskInstanceJournal::changeItem,
+              Qt::DirectConnection);
+      _webconsole->setTaskInstanceJournal(_journal);
+    } else {
+      Log::error() << "cannot open task instances journal, history won't be "
+                      "kept across restarts";
+      delete _journal;
+      _journal = nullptr;
+    }
+  }
   if (!_httpd->listen(_webconsoleAddress, _webconsolePort))
     Log::error() << "cannot start webconsole on "
                  << _webconsoleAddress.toString() << ":" << _webconsolePort
@@ -105,30 +125,96 @@ void Qrond::startup(QByteArrayList args) {
     Log::fatal() << "qrond is aborting startup sequence";
     return;
   }
+  if (_journal && _requeuePendingRequests)
+    requeuePendingRequests();
 }
 
-bool Qrond::systemTriggeredLoadConfig(QString actor) {
-  bool result = loadConfig();
+void Qrond::requeuePendingRequests() {
+  // old instance id -> new one, for herd members to join their requeued lead
+  QHash<quint64,quint64> newIds;
+  // oldest first, so herd leads are requeued before their members
+  for (const auto &record: _journal->takePendingRequests()) {
+    // a lead that is not requeued is not known anymore to the scheduler,
+    // start a new herd in this case
+    quint64 herdid = newIds.value(record.herdid, 0);
+    auto instance = _scheduler->planTask(
+          record.taskid, record.params, record.force, herdid, {}, {}, 0,
+          "restart"_u8);
+    if (!instance) {
+      Log::warning(record.taskid, record.id)
+          << "cannot request task again after restart";
+      continue;
+    }
+    newIds.insert(record.id, instance.id().toNumber<quint64>());
+    Log::info(record.taskid, record.id)
+        << "requested task again after restart as task instance "
+        << instance.id();
+  }
+}
+
+static void auditLoadConfig(Qrond::ConfigLoadResult result,
+                            const QString &actor) {
   Log::info() << "AUDIT action: 'reload_config_file' "
-              << (result ? "result: success" : "result: failure")
+              << (result == Qrond::ConfigLoadActivated ? "result: success"
+                  : result == Qrond::ConfigLoadSuperseded
+                  ? "result: superseded" : "result: failure")
               << " actor: '" << actor << "'";
+}
+
+Qrond::ConfigLoadResult Qrond::systemTriggeredLoadConfig(QString actor) {
+  auto result = loadConfig();
+  auditLoadConfig(result, actor);
   return result;
 }
 
-bool Qrond::loadConfig() {
-  bool result = false;
+Qrond::ConfigLoadResult Qrond::loadConfig() {
+  quint64 loadId = ++_lastConfigLoadId;
+  // parsing can take seconds with large files, it's done by calling thread
+  // and only activation is done by main thread
+  SchedulerConfig config = parseConfigFile();
+  ConfigLoadResult result = ConfigLoadFailed;
   if (this->thread() == QThread::currentThread())
-    result = doLoadConfig();
+    result = activateConfig(config, loadId);
   else
-    QMetaObject::invokeMethod(this, [this,&result]() {
-      result = doLoadConfig();
+    QMetaObject::invokeMethod(this, [this,&result,&config,loadId]() {
+      result = activateConfig(config, loadId);
     }, Qt::BlockingQueuedConnection);
   return result;
 }
 
-bool Qrond::doLoadConfig() {
+void Qrond::asyncLoadConfig(QString actor) {
+  quint64 loadId = ++_lastConfigLoadId;
+  auto thread = QThread::create([this,actor,loadId]() {
+    SchedulerConfig config = parseConfigFile();
+    QMetaObject::invokeMethod(this, [this,actor,loadId,config]() {
+      auto result = activateConfig(config, loadId);
+      auditLoadConfig(result, actor);
+    }, Qt::QueuedConnection);
+  });
+  thread->setObjectName("ConfigLoader");
+  connect(thread, &QThread::finished, thread, &QThread::deleteLater);
+  thread->start();
+}
+
+Qrond::ConfigLoadResult Qrond::activateConfig(SchedulerConfig config,
+                                              quint64 loadId) {
+  if (config.isNull() || _shutingDown)
+    return ConfigLoadFailed;
+  // concurrent loads may finish parsing out of order: never activate a config
+  // read from file before the active one
+  if (loadId < _activeConfigLoadId) {
+    Log::info() << "ignoring configuration " << config.id()
+                << " superseded by a more recent reload";
+    return ConfigLoadSuperseded;
+  }
+  _activeConfigLoadId = loadId;
+  _configRepository->addAndActivate(config);
+  return ConfigLoadActivated;
+}
+
+SchedulerConfig Qrond::parseConfigFile() {
   if (_configFilePath.isEmpty())
-    return false;
+    return SchedulerConfig();
   Log::info() << "loading configuration from file: " << _configFilePath;
   // LATER support a config directory like /etc/qron.d rather only one file
   QFile file(_configFilePath);
@@ -136,7 +222,7 @@ bool Qrond::doLoadConfig() {
   if (config.isNull()) {
     Log::error() << "cannot load configuration from file: "
                  << _configFilePath;
-    return false;
+    return config;
   }
   if (ParamsProvider::environment()->paramBool("DISABLE_TASKS_ON_CREATION")) {
     for (Task &t : config.tasks().values()) {
@@ -144,8 +230,7 @@ bool Qrond::doLoadConfig() {
       //emit itemChanged(t, t, QStringLiteral("task"));
     }
   }
-  _configRepository->addAndActivate(config);
-  return true;
+  return config;
 }
 
 void Qrond::systemTriggeredShutdown(int returnCode, QString actor) {
@@ -172,13 +257,24 @@ void Qrond::doShutdown(int returnCode) {
   _shutingDown = true;
   Log::info() << "qrond is shuting down";
   _httpd->close();
+  if (_journal) // before scheduler shutdown cancels them, if ever
+    _journal->savePendingRequests(
+          _scheduler->unfinishedTaskInstances().values());
   // wait for running tasks while starting new ones is disabled
   _scheduler->shutdown();
+  // flush last events (including shutdown ones) and compact journal
+  if (_journal) {
+    _webconsole->setTaskInstanceJournal(nullptr);
+    _journal->shutdown();
+  }
   // delete HttpServer and Scheduler
   // WebConsole will be deleted since HttpServer connects its deleteLater()
   _httpd->deleteLater(); // cannot be a child because it lives it its own thread
   // give a chance to WebConsole to fully shutdown before Scheduler deletion
   ::usleep(100000); // TODO replace with lambda connected on destroyed() ?
+  // same for requests still holding the journal
+  if (_journal)
+    _journal->deleteLater(); // cant be a child, it lives it its own thread
   _scheduler->deleteLater(); // cant be a child cause it lives it its own thread
   // give a chance for last main loop events, incl. QThread::deleteLater() for
   // HttpServer, Scheduler and children
@@ -198,7 +294,7 @@ void Qrond::signalCaught(int signal_number) {
       systemTriggeredShutdown(0, "signal");
       break;
     case SIGHUP:
-      systemTriggeredLoadConfig("signal");
+      asyncLoadConfig("signal");
       break;
 #endif
     default:
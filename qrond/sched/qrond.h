@@ -15,12 +15,14 @@
 #define QROND_H
 
 #include <QStringList>
+#include <QAtomicInteger>
 #include "sched/scheduler.h"
 #include "httpd/httpserver.h"
 #include "wui/webconsole.h"
 #include "httpd/basicauthhttphandler.h"
 #include "configmgt/localconfigrepository.h"
 #include "auth/inmemoryrulesauthorizer.h"
+#include "sched/taskinstancejournal.h"
 
 /** Operating system interface class.
   Mainly responsible for starting, shutting down and reloading the scheduler. */
@@ -32,29 +34,48 @@ class Qrond : public QObject {
   Scheduler *_scheduler;
   HttpServer *_httpd;
   QByteArray _configRepoPath, _configFilePath, _httpAuthRealm;
+  QByteArray _journalDirPath;
   BasicAuthHttpHandler *_httpAuthHandler;
   InMemoryRulesAuthorizer *_authorizer;
   LocalConfigRepository *_configRepository;
   WebConsole *_webconsole;
-  bool _shutingDown = false;
+  TaskInstanceJournal *_journal = nullptr;
+  bool _shutingDown = false, _requeuePendingRequests = false;
+  QAtomicInteger<quint64> _lastConfigLoadId;
+  quint64 _activeConfigLoadId = 0; // only accessed by main thread
 
 public:
+  enum ConfigLoadResult { ConfigLoadFailed = 0, ConfigLoadActivated,
+                          ConfigLoadSuperseded };
   explicit Qrond(QObject *parent = 0);
   ~Qrond();
   static Qrond *instance();
   Q_INVOKABLE void startup(QByteArrayList args);
-  /** This method is thread-safe */
-  bool loadConfig();
+  /** Parse config file in calling thread then activate it in main thread,
+   * waiting for completion.
+   * This method is thread-safe */
+  ConfigLoadResult loadConfig();
+  /** Parse config file in a dedicated thread then activate it, without
+   * waiting for completion, then audit result with given actor.
+   * This method is thread-safe */
+  void asyncLoadConfig(QString actor);
   /** This method is thread-safe */
   void shutdown(int returnCode);
   /** This method is thread-safe */
   void asyncShutdown(int returnCode);
-  bool systemTriggeredLoadConfig(QString actor);
+  /** Same as loadConfig(), then audit result with given actor.
+   * This method is thread-safe */
+  ConfigLoadResult systemTriggeredLoadConfig(QString actor);
   void systemTriggeredShutdown(int returnCode, QString actor);
 
 private:
-  bool doLoadConfig();
+  /** This method is thread-safe */
+  SchedulerConfig parseConfigFile();
+  /** Must be called by main thread */
+  ConfigLoadResult activateConfig(SchedulerConfig config, quint64 loadId);
   void doShutdown(int returnCode);
+  /** request again tasks which instances were pending when qrond stopped */
+  void requeuePendingRequests();
   void signalCaught(int signal_number);
 };
 
@@ -0,0 +1,554 @@
+/* Copyright 2026 Hallowyn and others.
+ * This file is part of qron, see <http://qron.eu/>.
+ * Qron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Qron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with qron. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "taskinstancejournal.h"
+#include <QThread>
+#include <QTimer>
+#include <QFile>
+#include <QSaveFile>
+#include <QDir>
+#include <QElapsedTimer>
+#include <QtEndian>
+#include "log/log.h"
+#include <unistd.h>
+
+#define SEGMENT_MAGIC "QRONJNL2"_ba
+#define SNAPSHOT_MAGIC "QRONSNP2"_ba
+#define PENDING_MAGIC "QRONPND2"_ba
+#define PENDING_FILE "pending.jnl"_s
+#define DEPTH_FILE "depth"_s
+#define SEGMENT_PREFIX "segment-"_s
+#define SNAPSHOT_PREFIX "snapshot-"_s
+#define FILE_SUFFIX ".jnl"_s
+#define COMMIT_INTERVAL_MS 200
+#define MAX_SEGMENT_SIZE (16*1024*1024)
+#define ROTATIONS_BETWEEN_SNAPSHOTS 8
+// record header: payload size (32 bits) + payload checksum (16 bits)
+#define RECORD_HEADER_SIZE 6
+// 4 64 bits numbers and 2 strings of at least their 16 bits size
+#define RECORD_MIN_PAYLOAD_SIZE 36
+
+TaskInstanceJournalRecord::TaskInstanceJournalRecord(
+    const TaskInstance &instance)
+  : id(instance.id().toNumber<quint64>()), taskid(instance.taskId()),
+    status(instance.statusAsString()) {
+  auto dt = instance.creationDatetime();
+  creation = dt.isValid() ? dt.toMSecsSinceEpoch() : 0;
+  dt = instance.startDatetime();
+  start = dt.isValid() ? dt.toMSecsSinceEpoch() : 0;
+  dt = instance.finishDatetime();
+  finish = dt.isValid() ? dt.toMSecsSinceEpoch() : 0;
+  if (isPending()) {
+    herdid = instance.herdid();
+    force = instance.force();
+    params = instance.params();
+  }
+}
+
+template<typename T>
+static inline void appendNumber(QByteArray *out, T value) {
+  T le = qToLittleEndian(value);
+  out->append(reinterpret_cast<const char*>(&le), sizeof le);
+}
+
+static inline void appendString(QByteArray *out, const QByteArray &s) {
+  quint16 size = qMin<qsizetype>(s.size(), 0xffff);
+  appendNumber(out, size);
+  out->append(s.constData(), size);
+}
+
+static void appendRecord(QByteArray *out,
+                         const TaskInstanceJournalRecord &record) {
+  QByteArray payload;
+  payload.reserve(RECORD_MIN_PAYLOAD_SIZE+record.taskid.size()
+                  +record.status.size());
+  appendNumber(&payload, record.id);
+  appendNumber(&payload, record.creation);
+  appendNumber(&payload, record.start);
+  appendNumber(&payload, record.finish);
+  appendString(&payload, record.taskid);
+  appendString(&payload, record.status);
+  // pending requests also need what's needed to request them again
+  if (record.isPending()) {
+    appendNumber(&payload, record.herdid);
+    appendNumber<quint8>(&payload, record.force);
+    auto keys = record.params.paramKeys();
+    appendNumber<quint16>(&payload, qMin<qsizetype>(keys.size(), 0xffff));
+    int i = 0;
+    for (const auto &key: keys) {
+      if (i++ == 0xffff)
+        break;
+      appendString(&payload, key);
+      appendString(&payload, record.params.paramRawUtf8(key));
+    }
+  }
+  appendNumber<quint32>(out, payload.size());
+  appendNumber<quint16>(out, qChecksum(payload));
+  out->append(payload);
+}
+
+static inline bool readString(const uchar **p, const uchar *end,
+                              Utf8String *s) {
+  if (end-*p < 2)
+    return false;
+  quint16 size = qFromLittleEndian<quint16>(*p);
+  *p += 2;
+  if (end-*p < size)
+    return false;
+  *s = QByteArray(reinterpret_cast<const char*>(*p), size);
+  *p += size;
+  return true;
+}
+
+/** @return size of decoded record including its header, 0 if the data is
+ * truncated or corrupted */
+static qsizetype readRecord(const uchar *p, qsizetype remaining,
+                            TaskInstanceJournalRecord *record) {
+  if (remaining < RECORD_HEADER_SIZE)
+    return 0;
+  quint32 size = qFromLittleEndian<quint32>(p);
+  quint16 checksum = qFromLittleEndian<quint16>(p+4);
+  if (size < RECORD_MIN_PAYLOAD_SIZE || size > remaining-RECORD_HEADER_SIZE)
+    return 0;
+  p += RECORD_HEADER_SIZE;
+  if (qChecksum(QByteArrayView(p, size)) != checksum)
+    return 0;
+  const uchar *end = p+size;
+  record->id = qFromLittleEndian<quint64>(p);
+  record->creation = qFromLittleEndian<qint64>(p+8);
+  record->start = qFromLittleEndian<qint64>(p+16);
+  record->finish = qFromLittleEndian<qint64>(p+24);
+  p += 32;
+  if (!readString(&p, end, &record->taskid)
+      || !readString(&p, end, &record->status))
+    return 0;
+  record->herdid = 0;
+  record->force = false;
+  record->params = ParamSet();
+  if (record->isPending()) {
+    if (end-p < 11)
+      return 0;
+    record->herdid = qFromLittleEndian<quint64>(p);
+    record->force = p[8];
+    quint16 count = qFromLittleEndian<quint16>(p+9);
+    p += 11;
+    Utf8String key, value;
+    for (int i = 0; i < count; ++i) {
+      if (!readString(&p, end, &key) || !readString(&p, end, &value))
+        return 0;
+      record->params.insert(key, value);
+    }
+  }
+  return RECORD_HEADER_SIZE+size;
+}
+
+static inline QString fileName(const QString &prefix, quint64 seq) {
+  // zero padding makes name order the same than seq order
+  return prefix+QString::number(seq).rightJustified(16, '0')+FILE_SUFFIX;
+}
+
+static inline quint64 seqFromFileName(const QString &prefix,
+                                      const QString &name) {
+  return name.mid(prefix.size(), name.size()-prefix.size()-FILE_SUFFIX.size())
+      .toULongLong();
+}
+
+TaskInstanceJournal::TaskInstanceJournal(QString dirPath, int depth)
+  : _thread(new QThread), _commitTimer(new QTimer(this)), _dirPath(dirPath),
+    _segment(nullptr), _segmentSeq(0), _rotationsSinceSnapshot(0),
+    _depth(qMax(depth, 1)) {
+  _commitTimer->setInterval(COMMIT_INTERVAL_MS);
+  connect(_commitTimer, &QTimer::timeout,
+          this, &TaskInstanceJournal::commit);
+}
+
+TaskInstanceJournal::~TaskInstanceJournal() {
+  if (!_thread->isRunning()) // open() was never called or failed
+    delete _thread;
+  delete _segment;
+}
+
+bool TaskInstanceJournal::open() {
+  QElapsedTimer timer;
+  timer.start();
+  QDir dir(_dirPath);
+  if (!dir.mkpath(".")) {
+    Log::error() << "cannot create task instances journal directory: "
+                 << _dirPath;
+    return false;
+  }
+  QFile depthFile(dir.filePath(DEPTH_FILE));
+  if (depthFile.open(QIODevice::ReadOnly)) {
+    int depth = depthFile.readAll().trimmed().toInt();
+    if (depth > 0)
+      _depth = depth;
+  }
+  // pending requests saved at shutdown, loaded before replaying events so that
+  // those started after being saved are dropped by indexRecord()
+  QString pendingPath = dir.filePath(PENDING_FILE);
+  bool pendingSaved = QFile::exists(pendingPath);
+  if (pendingSaved) {
+    QList<TaskInstanceJournalRecord> records;
+    if (!loadFile(pendingPath, PENDING_MAGIC, &records))
+      Log::warning() << "ignoring unreadable task instances journal pending "
+                        "requests file: " << pendingPath;
+    for (const auto &record: records)
+      _savedRequests.insert(record.id, record);
+  }
+  quint64 snapshotSeq = 0, lastSegmentSeq = 0;
+  auto snapshots = dir.entryList({ SNAPSHOT_PREFIX+"*"+FILE_SUFFIX },
+                                 QDir::Files, QDir::Name|QDir::Reversed);
+  for (const QString &name: snapshots) {
+    if (loadFile(dir.filePath(name), SNAPSHOT_MAGIC)) {
+      snapshotSeq = seqFromFileName(SNAPSHOT_PREFIX, name);
+      break;
+    }
+    Log::warning() << "ignoring unreadable task instances journal snapshot: "
+                   << name;
+    _recent.clear();
+    _unfinished.clear();
+  }
+  int replayed = 0;
+  auto segments = dir.entryList({ SEGMENT_PREFIX+"*"+FILE_SUFFIX },
+                                QDir::Files, QDir::Name);
+  for (const QString &name: segments) {
+    quint64 seq = seqFromFileName(SEGMENT_PREFIX, name);
+    lastSegmentSeq = qMax(lastSegmentSeq, seq);
+    if (seq < snapshotSeq) // already compacted in snapshot
+      continue;
+    if (loadFile(dir.filePath(name), SEGMENT_MAGIC))
+      ++replayed;
+  }
+  // pending requests are those saved at shutdown, otherwise (crash) those
+  // replayed as planned or queued
+  if (pendingSaved) {
+    _pendingRequests = _savedRequests.values();
+    _savedRequests.clear();
+    _savedRequestsChanged = false;
+    dir.remove(PENDING_FILE);
+  }
+  closeUnfinishedRecords(!pendingSaved);
+  // never append to an old segment, which tail may be a torn write
+  if (!openSegment(qMax(lastSegmentSeq+1, snapshotSeq)))
+    return false;
+  // compact what was just reloaded, for next startup to be fast as well
+  if (replayed)
+    writeSnapshot(_segmentSeq);
+  qsizetype count = 0;
+  for (const auto &list: _recent)
+    count += list.size();
+  Log::info() << "reloaded " << count << " task instances of "
+              << _recent.size() << " tasks from journal " << _dirPath
+              << " (" << replayed << " segments replayed, "
+              << _pendingRequests.size() << " pending requests) in "
+              << timer.elapsed() << " ms";
+  _thread->setObjectName("TaskInstanceJournal");
+  connect(this, &TaskInstanceJournal::destroyed, _thread, &QThread::quit);
+  connect(_thread, &QThread::finished, _thread, &QThread::deleteLater);
+  _thread->start();
+  moveToThread(_thread);
+  QMetaObject::invokeMethod(this, [this]() {
+    _commitTimer->start();
+  }, Qt::QueuedConnection);
+  return true;
+}
+
+bool TaskInstanceJournal::loadFile(
+    const QString &path, const QByteArray &magic,
+    QList<TaskInstanceJournalRecord> *records) {
+  QFile file(path);
+  if (!file.open(QIODevice::ReadOnly)) {
+    Log::warning() << "cannot open task instances journal file " << path
+                   << " : " << file.errorString();
+    return false;
+  }
+  qint64 size = file.size();
+  if (size < magic.size())
+    return false;
+  const uchar *data = file.map(0, size);
+  QByteArray buffer;
+  if (!data) { // should never happen for regular files
+    buffer = file.readAll();
+    data = reinterpret_cast<const uchar*>(buffer.constData());
+  }
+  if (QByteArrayView(data, magic.size()) != magic)
+    return false;
+  qint64 offset = magic.size();
+  TaskInstanceJournalRecord record;
+  QWriteLocker locker(&_recentLock);
+  while (offset < size) {
+    auto consumed = readRecord(data+offset, size-offset, &record);
+    if (!consumed) {
+      // expected at the end of last segment after a crash
+      Log::warning() << "ignoring " << size-offset
+                     << " bytes of truncated or corrupted data at offset "
+                     << offset << " in task instances journal file " << path;
+      break;
+    }
+    if (records)
+      records->append(record);
+    else
+      indexRecord(record);
+    offset += consumed;
+  }
+  return true;
+}
+
+void TaskInstanceJournal::indexRecord(
+    const TaskInstanceJournalRecord &record) {
+  // tracked whatever depth, since pending requests must not depend on how
+  // many instances are kept for display
+  if (record.isUnfinished())
+    _unfinished.insert(record.id, record);
+  else
+    _unfinished.remove(record.id);
+  if (record.isStarted() && _savedRequests.remove(record.id)) {
+    Log::info(record.taskid, record.id)
+        << "not keeping task instance as pending request since it was "
+        << record.status << " after being saved";
+    _savedRequestsChanged = true;
+  }
+  auto &list = _recent[record.taskid];
+  auto it = std::find_if(list.begin(), list.end(), [&record](const auto &r) {
+    return r.id == record.id;
+  });
+  if (it != list.end()) {
+    *it = record;
+    return;
+  }
+  // instance ids are increasing with time, so this is most likely at begin
+  it = std::lower_bound(list.begin(), list.end(), record.id,
+                        [](const TaskInstanceJournalRecord &r, quint64 id) {
+    return r.id > id;
+  });
+  list.insert(it, record);
+  if (list.size() > _depth)
+    list.removeLast();
+}
+
+void TaskInstanceJournal::closeUnfinishedRecords(bool keepPending) {
+  auto now = QDateTime::currentMSecsSinceEpoch();
+  auto canceled = "canceled"_u8;
+  QWriteLocker locker(&_recentLock);
+  const auto unfinished = _unfinished.values();
+  for (auto record: unfinished) {
+    if (record.isPending()) {
+      if (keepPending)
+        _pendingRequests.append(record);
+    } else {
+      Log::warning(record.taskid, record.id)
+          << "task instance was " << record.status
+          << " when qrond stopped, its outcome is unknown";
+    }
+    record.status = canceled;
+    record.finish = now;
+    indexRecord(record);
+    _pendingRecords.append(record);
+  }
+  std::sort(_pendingRequests.begin(), _pendingRequests.end(),
+            [](const TaskInstanceJournalRecord &a,
+               const TaskInstanceJournalRecord &b) {
+    return a.id < b.id;
+  });
+}
+
+void TaskInstanceJournal::savePendingRequests(
+    const QList<TaskInstance> &instances) {
+  QByteArray data;
+  { QWriteLocker locker(&_recentLock);
+    _savedRequests.clear();
+    for (const auto &instance: instances) {
+      TaskInstanceJournalRecord record(instance);
+      if (record.isPending())
+        _savedRequests.insert(record.id, record);
+    }
+    _savedRequestsChanged = false;
+    data = savedRequestsData();
+  }
+  writePendingFile(data);
+}
+
+QByteArray TaskInstanceJournal::savedRequestsData() const {
+  QByteArray data = PENDING_MAGIC;
+  for (const auto &record: _savedRequests)
+    appendRecord(&data, record);
+  return data;
+}
+
+void TaskInstanceJournal::writePendingFile(const QByteArray &data) {
+  QSaveFile file(QDir(_dirPath).filePath(PENDING_FILE));
+  if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()
+      || !file.commit())
+    Log::error() << "cannot write task instances journal pending requests "
+                 << file.fileName() << " : " << file.errorString();
+}
+
+QList<TaskInstanceJournalRecord> TaskInstanceJournal::takePendingRequests() {
+  QList<TaskInstanceJournalRecord> records;
+  records.swap(_pendingRequests);
+  return records;
+}
+
+bool TaskInstanceJournal::openSegment(quint64 seq) {
+  delete _segment;
+  _segmentSeq = seq;
+  _segment = new QFile(QDir(_dirPath).filePath(fileName(SEGMENT_PREFIX, seq)));
+  if (!_segment->open(QIODevice::WriteOnly|QIODevice::Truncate)
+      || _segment->write(SEGMENT_MAGIC) != SEGMENT_MAGIC.size()) {
+    Log::error() << "cannot open task instances journal segment "
+                 << _segment->fileName() << " : " << _segment->errorString();
+    delete _segment;
+    _segment = nullptr;
+    return false;
+  }
+  return true;
+}
+
+void TaskInstanceJournal::writeSnapshot(quint64 seq) {
+  QDir dir(_dirPath);
+  QByteArray data = SNAPSHOT_MAGIC;
+  { QReadLocker locker(&_recentLock);
+    for (const auto &list: _recent)
+      for (const auto &record: list)
+        appendRecord(&data, record);
+    // unfinished instances beyond depth, to find pending requests after a
+    // crash
+    for (const auto &record: _unfinished) {
+      const auto list = _recent.value(record.taskid);
+      bool written = std::any_of(list.begin(), list.end(),
+                                 [&record](const auto &r) {
+        return r.id == record.id;
+      });
+      if (!written)
+        appendRecord(&data, record);
+    }
+  }
+  QSaveFile file(dir.filePath(fileName(SNAPSHOT_PREFIX, seq)));
+  if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()
+      || !file.commit()) {
+    Log::error() << "cannot write task instances journal snapshot "
+                 << file.fileName() << " : " << file.errorString();
+    return;
+  }
+  _rotationsSinceSnapshot = 0;
+  // older snapshots and segments are now useless
+  for (const QString &name: dir.entryList(
+         { SNAPSHOT_PREFIX+"*"+FILE_SUFFIX }, QDir::Files))
+    if (seqFromFileName(SNAPSHOT_PREFIX, name) < seq)
+      dir.remove(name);
+  for (const QString &name: dir.entryList(
+         { SEGMENT_PREFIX+"*"+FILE_SUFFIX }, QDir::Files))
+    if (seqFromFileName(SEGMENT_PREFIX, name) < seq)
+      dir.remove(name);
+}
+
+void TaskInstanceJournal::changeItem(
+    const SharedUiItem &newItem, const SharedUiItem &,
+    const Utf8String &idQualifier) {
+  if (idQualifier != "taskinstance"_u8 || newItem.isNull())
+    return;
+  // called by scheduler thread: only keep an implicitly shared copy, records
+  // are built, indexed and written by journal thread
+  QMutexLocker locker(&_pendingMutex);
+  _pendingInstances.append(static_cast<const TaskInstance&>(newItem));
+}
+
+void TaskInstanceJournal::commit() {
+  QList<TaskInstance> instances;
+  QList<TaskInstanceJournalRecord> records;
+  { QMutexLocker locker(&_pendingMutex);
+    instances.swap(_pendingInstances);
+    records.swap(_pendingRecords);
+  }
+  if (instances.isEmpty() && records.isEmpty())
+    return;
+  for (const auto &instance: instances)
+    records.append(TaskInstanceJournalRecord(instance));
+  QByteArray data;
+  { QWriteLocker locker(&_recentLock);
+    for (const auto &record: records) {
+      indexRecord(record);
+      appendRecord(&data, record);
+    }
+  }
+  if (!_segment)
+    return;
+  // group commit: one write and one sync for every event since last commit
+  if (_segment->write(data) != data.size() || !_segment->flush()) {
+    Log::error() << "cannot write to task instances journal segment "
+                 << _segment->fileName() << " : " << _segment->errorString();
+    return;
+  }
+  ::fdatasync(_segment->handle());
+  // saved requests started since last commit: rewrite them only once their
+  // start is synced, for a crash in between to be caught by next reload
+  QByteArray savedRequests;
+  { QWriteLocker locker(&_recentLock);
+    if (_savedRequestsChanged) {
+      savedRequests = savedRequestsData();
+      _savedRequestsChanged = false;
+    }
+  }
+  if (!savedRequests.isEmpty())
+    writePendingFile(savedRequests);
+  if (_segment->size() < MAX_SEGMENT_SIZE)
+    return;
+  if (!openSegment(_segmentSeq+1))
+    return;
+  if (++_rotationsSinceSnapshot >= ROTATIONS_BETWEEN_SNAPSHOTS)
+    writeSnapshot(_segmentSeq);
+}
+
+void TaskInstanceJournal::shutdown() {
+  if (thread() == QThread::currentThread())
+    doShutdown();
+  else
+    QMetaObject::invokeMethod(this, [this]() {
+      doShutdown();
+    }, Qt::BlockingQueuedConnection);
+}
+
+void TaskInstanceJournal::doShutdown() {
+  _commitTimer->stop();
+  commit();
+  if (!_segment)
+    return;
+  // snapshot covers current segment as well, which can thus be removed
+  writeSnapshot(_segmentSeq+1);
+  delete _segment;
+  _segment = nullptr;
+}
+
+void TaskInstanceJournal::setDepth(int depth) {
+  depth = qMax(depth, 1);
+  { QWriteLocker locker(&_recentLock);
+    if (depth == _depth)
+      return;
+    _depth = depth;
+    for (auto &list: _recent)
+      if (list.size() > depth)
+        list.resize(depth);
+  }
+  QSaveFile file(QDir(_dirPath).filePath(DEPTH_FILE));
+  QByteArray data = QByteArray::number(depth)+'\n';
+  if (!file.open(QIODevice::WriteOnly) || file.write(data) != data.size()
+      || !file.commit())
+    Log::error() << "cannot write task instances journal depth "
+                 << file.fileName() << " : " << file.errorString();
+}
+
+QList<TaskInstanceJournalRecord> TaskInstanceJournal::lastRecordsByTaskId(
+    const Utf8String &taskId, int depth) const {
+  QReadLocker locker(&_recentLock);
+  return _recent.value(taskId).mid(0, depth);
+}
@@ -0,0 +1,152 @@
+/* Copyright 2026 Hallowyn and others.
+ * This file is part of qron, see <http://qron.eu/>.
+ * Qron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Qron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with qron. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TASKINSTANCEJOURNAL_H
+#define TASKINSTANCEJOURNAL_H
+
+#include <QObject>
+#include <QMutex>
+#include <QReadWriteLock>
+#include <QHash>
+#include <QDateTime>
+#include "sched/taskinstance.h"
+
+class QThread;
+class QTimer;
+class QFile;
+
+/** Last known state of a task instance, as recorded in the journal. */
+struct TaskInstanceJournalRecord {
+  quint64 id = 0;
+  Utf8String taskid, status;
+  // milliseconds since epoch, 0 when not set
+  qint64 creation = 0, start = 0, finish = 0;
+  // only kept for pending requests, to request them again the same way
+  quint64 herdid = 0;
+  bool force = false;
+  ParamSet params;
+
+  TaskInstanceJournalRecord() { }
+  explicit TaskInstanceJournalRecord(const TaskInstance &instance);
+  bool isNull() const { return !id; }
+  /** planned or queued */
+  bool isPending() const { return status == "planned" || status == "queued"; }
+  bool isUnfinished() const {
+    return isPending() || status == "running" || status == "waiting"; }
+  /** running, waiting or finished otherwise than canceled */
+  bool isStarted() const { return !isPending() && status != "canceled"; }
+  QDateTime creationDatetime() const { return datetime(creation); }
+  QDateTime startDatetime() const { return datetime(start); }
+  QDateTime finishDatetime() const { return datetime(finish); }
+  /** 0 if not started, time since start if not finished */
+  qint64 durationMillis() const {
+    return start ? (finish ? finish : QDateTime::currentMSecsSinceEpoch())
+                   - start : 0; }
+
+private:
+  static QDateTime datetime(qint64 msecs) {
+    return msecs ? QDateTime::fromMSecsSinceEpoch(msecs) : QDateTime(); }
+};
+
+/** Persistent append-only journal of task instances lifecycle events, used to
+ * keep task instances history across qrond restarts.
+ *
+ * Events are buffered by changeItem() which is cheap and thread-safe and are
+ * written by the journal own thread in batches (group commit: one write and
+ * one fdatasync per batch) to segment files, rotated past a given size.
+ * Every few rotations the recent history is written as a compacted snapshot
+ * and older segments are removed, so that reload at startup only maps one
+ * snapshot and a few segments, regardless of how many events were journaled.
+ *
+ * Instances that were still waiting for execution when qrond stopped (saved
+ * at shutdown, or last journaled as planned or queued after a crash) are kept
+ * apart at reload so that they can be requested again.
+ */
+class TaskInstanceJournal : public QObject {
+  Q_OBJECT
+  Q_DISABLE_COPY(TaskInstanceJournal)
+  QThread *_thread;
+  QTimer *_commitTimer;
+  QString _dirPath;
+  QFile *_segment;
+  quint64 _segmentSeq;
+  int _rotationsSinceSnapshot, _depth;
+  QMutex _pendingMutex;
+  QList<TaskInstance> _pendingInstances;
+  QList<TaskInstanceJournalRecord> _pendingRecords;
+  mutable QReadWriteLock _recentLock;
+  // task id -> last records for this task, most recent first
+  QHash<Utf8String,QList<TaskInstanceJournalRecord>> _recent;
+  // id -> last record of every unfinished instance, whatever depth
+  QHash<quint64,TaskInstanceJournalRecord> _unfinished;
+  // id -> request saved at shutdown and not started since
+  QHash<quint64,TaskInstanceJournalRecord> _savedRequests;
+  bool _savedRequestsChanged = false;
+  QList<TaskInstanceJournalRecord> _pendingRequests;
+
+public:
+  /** @param depth max number of instances kept per task, overridden by the
+   * one last set with setDepth(), if any */
+  TaskInstanceJournal(QString dirPath, int depth = 10);
+  ~TaskInstanceJournal();
+  /** Reload history from disk, then start journaling in a dedicated thread.
+   * Must be called once, from the thread that created the journal. */
+  bool open();
+  /** Flush pending events, write a snapshot and stop journaling.
+   * This method is thread-safe. */
+  void shutdown();
+  /** Most recent first.
+   * This method is thread-safe. */
+  QList<TaskInstanceJournalRecord> lastRecordsByTaskId(
+      const Utf8String &taskId, int depth) const;
+  /** Save planned and queued instances among given ones, along with their
+   * overriding params and herd, for them to be available through
+   * takePendingRequests() at next startup. Should be called at shutdown
+   * before the scheduler stops. Those that start nevertheless are dropped as
+   * soon as their start is journaled.
+   * This method is thread-safe. */
+  void savePendingRequests(const QList<TaskInstance> &instances);
+  /** Instances that were waiting for execution when qrond stopped, oldest
+   * first. Available once, after open(). */
+  QList<TaskInstanceJournalRecord> takePendingRequests();
+  QString dirPath() const { return _dirPath; }
+  /** Change max number of instances kept per task, which is remembered in
+   * the journal directory so that next reload keeps as many.
+   * This method is thread-safe. */
+  void setDepth(int depth);
+
+public slots:
+  /** Record item if it's a task instance, ignore it otherwise.
+   * This method is thread-safe. */
+  void changeItem(const SharedUiItem &newItem, const SharedUiItem &oldItem,
+                  const Utf8String &idQualifier);
+
+private:
+  void commit();
+  void doShutdown();
+  bool openSegment(quint64 seq);
+  /** write a snapshot covering every segment before seq */
+  void writeSnapshot(quint64 seq);
+  /** index records, or append them to records if not null */
+  bool loadFile(const QString &path, const QByteArray &magic,
+                QList<TaskInstanceJournalRecord> *records = nullptr);
+  /** journal replayed unfinished instances, whatever depth, as canceled since
+   * they are no longer known to the scheduler, and keep pending ones apart */
+  void closeUnfinishedRecords(bool keepPending);
+  /** caller must hold _recentLock */
+  QByteArray savedRequestsData() const;
+  void writePendingFile(const QByteArray &data);
+  void indexRecord(const TaskInstanceJournalRecord &record);
+};
+
+#endif // TASKINSTANCEJOURNAL_H
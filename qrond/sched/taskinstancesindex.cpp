@@ -0,0 +1,178 @@
+/* Copyright 2026 Hallowyn and others.
+ * This file is part of qron, see <http://qron.eu/>.
+ * Qron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Qron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with qron. If not, see <http://www.gnu.org/licenses/>.
+ */
+#include "taskinstancesindex.h"
+
+static inline bool isUnfinished(const Utf8String &status) {
+  return status == "planned" || status == "queued" || status == "running"
+      || status == "waiting";
+}
+
+static inline bool isUnfinished(const TaskInstance &instance) {
+  return isUnfinished(instance.statusAsString());
+}
+
+TaskInstancesIndex::TaskInstancesIndex(QObject *parent, int depth)
+  : QObject(parent), _depth(qMax(depth, 1)) {
+}
+
+int TaskInstancesIndex::depth() const {
+  QReadLocker locker(&_lock);
+  return _depth;
+}
+
+void TaskInstancesIndex::setDepth(int depth) {
+  depth = qMax(depth, 1);
+  QWriteLocker locker(&_lock);
+  if (depth == _depth)
+    return;
+  for (auto &ids: _lastIds) {
+    for (qsizetype i = depth; i < ids.size(); ++i) {
+      _instances.remove(ids[i]);
+      removeHerdIfDone(ids[i]);
+    }
+    if (ids.size() > depth)
+      ids.resize(depth);
+  }
+  _depth = depth;
+}
+
+QList<TaskInstance> TaskInstancesIndex::lastInstancesByTaskId(
+    const Utf8String &taskId, int depth) const {
+  QList<TaskInstance> instances;
+  QReadLocker locker(&_lock);
+  auto it = _lastIds.constFind(taskId);
+  if (it == _lastIds.cend())
+    return instances;
+  for (auto id: it->mid(0, depth))
+    instances.append(_instances.value(id));
+  return instances;
+}
+
+TaskInstance TaskInstancesIndex::taskInstanceById(
+    quint64 taskInstanceId) const {
+  QReadLocker locker(&_lock);
+  return _instances.value(taskInstanceId);
+}
+
+void TaskInstancesIndex::changeItem(
+    const SharedUiItem &newItem, const SharedUiItem &,
+    const Utf8String &idQualifier) {
+  if (idQualifier != "taskinstance"_u8 || newItem.isNull())
+    return;
+  auto &instance = static_cast<const TaskInstance&>(newItem);
+  auto id = instance.id().toNumber<quint64>();
+  QWriteLocker locker(&_lock);
+  updateUnfinished(instance);
+  auto it = _instances.find(id);
+  if (it != _instances.end()) { // transition of an already indexed instance
+    *it = instance;
+    updateHerd(instance, id);
+    return;
+  }
+  // instance ids are increasing with time, so this is most likely at begin,
+  // but transitions of instances already evicted from a full list (e.g. with
+  // more unfinished instances than depth) must not evict more recent ones
+  auto &ids = _lastIds[instance.taskId()];
+  auto pos = std::lower_bound(ids.begin(), ids.end(), id,
+                              [](quint64 a, quint64 b) { return a > b; });
+  if (pos == ids.end() && ids.size() >= _depth) { // older than whole list
+    updateHerd(instance, id);
+    return;
+  }
+  ids.insert(pos, id);
+  _instances.insert(id, instance);
+  if (ids.size() > _depth) { // evict oldest
+    auto evicted = ids.takeLast();
+    _instances.remove(evicted);
+    removeHerdIfDone(evicted);
+  }
+  updateHerd(instance, id);
+}
+
+void TaskInstancesIndex::updateHerd(const TaskInstance &instance,
+                                    quint64 id) {
+  auto herdid = instance.herdid();
+  if (!herdid)
+    return;
+  auto &herd = _herds[herdid];
+  herd.herdid = herdid;
+  auto status = instance.statusAsString();
+  auto it = herd.members.find(id);
+  if (it == herd.members.end()) {
+    herd.members.insert(id, status);
+    ++herd.statusCounts[status];
+    if (isUnfinished(status))
+      ++herd.unfinishedCount;
+  } else if (*it != status) {
+    if (--herd.statusCounts[*it] == 0)
+      herd.statusCounts.remove(*it);
+    if (isUnfinished(*it))
+      --herd.unfinishedCount;
+    *it = status;
+    ++herd.statusCounts[status];
+    if (isUnfinished(status))
+      ++herd.unfinishedCount;
+  }
+  auto start = instance.startDatetime();
+  if (start.isValid()) {
+    auto ms = start.toMSecsSinceEpoch();
+    herd.firstStart = herd.firstStart ? qMin(herd.firstStart, ms) : ms;
+  }
+  auto finish = instance.finishDatetime();
+  if (finish.isValid())
+    herd.lastFinish = qMax(herd.lastFinish, finish.toMSecsSinceEpoch());
+  if (!_instances.contains(herdid)) // lead already evicted
+    removeHerdIfDone(herdid);
+}
+
+void TaskInstancesIndex::removeHerdIfDone(quint64 herdid) {
+  auto it = _herds.find(herdid);
+  if (it != _herds.end() && !it->unfinishedCount)
+    _herds.erase(it);
+}
+
+TaskInstancesIndex::HerdSummary TaskInstancesIndex::herdSummary(
+    quint64 herdid) const {
+  QReadLocker locker(&_lock);
+  return _herds.value(herdid);
+}
+
+void TaskInstancesIndex::updateUnfinished(const TaskInstance &instance) {
+  // set elements are immutable: replace an updated instance by erasing it
+  _unfinished.erase(instance);
+  if (isUnfinished(instance))
+    _unfinished.insert(instance);
+  _unfinishedSnapshotValid = false;
+}
+
+SharedUiItemList TaskInstancesIndex::unfinishedTaskInstances() const {
+  QReadLocker locker(&_lock);
+  // several readers can hold the read lock, the snapshot needs its own mutex
+  QMutexLocker snapshotLocker(&_unfinishedSnapshotMutex);
+  if (!_unfinishedSnapshotValid) {
+    _unfinishedSnapshot = SharedUiItemList(_unfinished.begin(),
+                                           _unfinished.end());
+    _unfinishedSnapshotValid = true;
+  }
+  return _unfinishedSnapshot;
+}
+
+void TaskInstancesIndex::setUnfinishedTaskInstances(
+    const QList<TaskInstance> &instances) {
+  QWriteLocker locker(&_lock);
+  _unfinished.clear();
+  for (auto instance: instances)
+    updateUnfinished(instance);
+  _unfinishedSnapshotValid = false;
+}
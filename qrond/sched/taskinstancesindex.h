@@ -0,0 +1,96 @@
+/* Copyright 2026 Hallowyn and others.
+ * This file is part of qron, see <http://qron.eu/>.
+ * Qron is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU Affero General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ * Qron is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU Affero General Public License for more details.
+ * You should have received a copy of the GNU Affero General Public License
+ * along with qron. If not, see <http://www.gnu.org/licenses/>.
+ */
+#ifndef TASKINSTANCESINDEX_H
+#define TASKINSTANCESINDEX_H
+
+#include <QObject>
+#include <QReadWriteLock>
+#include <QMutex>
+#include <QHash>
+#include <set>
+#include "sched/taskinstance.h"
+
+/** In-memory index of recent task instances, fed by Scheduler::itemChanged
+ * through a queued connection (so that it runs in its own thread rather than
+ * scheduler's one) and updated on each task instance transition.
+ *
+ * Keeps for every task the ids of its depth most recent instances, ordered
+ * by id whatever the order of their transitions, and a hash of every indexed
+ * instance by id, so that task and task instance pages cost O(depth)
+ * regardless of how many instances were ever run.
+ *
+ * Also keeps unfinished instances in an ordered set updated in O(log n) at
+ * transition time, read through a sorted snapshot which is rebuilt in O(n) at
+ * most once per change, and per herd aggregates updated as herd members
+ * transition.
+ *
+ * All public methods are thread-safe. */
+class TaskInstancesIndex : public QObject {
+  Q_OBJECT
+  Q_DISABLE_COPY(TaskInstancesIndex)
+public:
+  /** Aggregated state of a herd, null if unknown. */
+  struct HerdSummary {
+    quint64 herdid = 0;
+    QHash<quint64,Utf8String> members; // task instance id -> status
+    QHash<Utf8String,int> statusCounts;
+    int unfinishedCount = 0;
+    // milliseconds since epoch, 0 when not set
+    qint64 firstStart = 0, lastFinish = 0;
+    bool isNull() const { return !herdid; }
+  };
+
+private:
+  mutable QReadWriteLock _lock;
+  int _depth;
+  // task id -> ids of last instances of this task, most recent first
+  QHash<Utf8String,QList<quint64>> _lastIds;
+  QHash<quint64,TaskInstance> _instances;
+  std::set<SharedUiItem> _unfinished;
+  mutable QMutex _unfinishedSnapshotMutex;
+  mutable SharedUiItemList _unfinishedSnapshot;
+  mutable bool _unfinishedSnapshotValid = true;
+  QHash<quint64,HerdSummary> _herds;
+
+public:
+  explicit TaskInstancesIndex(QObject *parent = 0, int depth = 10);
+  int depth() const;
+  /** Change number of instances kept per task, keeping most recent ones. */
+  void setDepth(int depth);
+  /** Most recent first, at most depth() instances. */
+  QList<TaskInstance> lastInstancesByTaskId(const Utf8String &taskId,
+                                            int depth) const;
+  /** Null if unknown or no longer among recent instances of its task. */
+  TaskInstance taskInstanceById(quint64 taskInstanceId) const;
+  /** Sorted, same order than std::sort() would give. */
+  SharedUiItemList unfinishedTaskInstances() const;
+  /** Reset unfinished instances, e.g. with Scheduler's ones at startup. */
+  void setUnfinishedTaskInstances(const QList<TaskInstance> &instances);
+  /** Kept while the herd has unfinished members or its lead is indexed. */
+  HerdSummary herdSummary(quint64 herdid) const;
+
+public slots:
+  void changeItem(const SharedUiItem &newItem, const SharedUiItem &oldItem,
+                  const Utf8String &idQualifier);
+
+private:
+  /** Caller must hold lock. */
+  void updateUnfinished(const TaskInstance &instance);
+  /** Caller must hold lock. */
+  void updateHerd(const TaskInstance &instance, quint64 id);
+  /** Caller must hold lock. */
+  void removeHerdIfDone(quint64 herdid);
+};
+
+#endif // TASKINSTANCESINDEX_H
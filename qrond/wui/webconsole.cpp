@@ -61,7 +61,9 @@ static HtmlTableFormatter _htmlTableFormatter(-1);
 
 WebConsole::WebConsole() : _thread(new QThread), _scheduler(0),
   _configRepository(0), _authorizer(0),
-  _readOnlyResourcesCache(new ReadOnlyResourcesCache(this)) {
+  _readOnlyResourcesCache(new ReadOnlyResourcesCache(this)),
+  _taskInstanceJournal(nullptr),
+  _taskInstancesIndex(new TaskInstancesIndex(this)) {
 
   // HTTP handlers
   _tasksDeploymentDiagram = new GraphvizImageHttpHandler(this);
@@ -711,12 +713,6 @@ inline bool writeItemsAsHtmlTable(
   return true;
 }
 
-inline bool sortAndWriteItemsAsHtmlTable(
-    SharedUiItemList list, const HttpRequest &req, HttpResponse &res) {
-  std::sort(list.begin(), list.end());
-  return writeItemsAsHtmlTable(list, req, res);
-}
-
 #if 0
 static bool writeSvgImage(QByteArray data, HttpRequest req,
                           HttpResponse res) {
@@ -1123,15 +1119,31 @@ static RadixTree<HandlerFunction> _handlers {
     [](WebConsole *webconsole, HttpRequest &req, HttpResponse &res, ParamsProviderMerger &context, int ml) STATIC_LAMBDA -> bool {
       if (!enforceMethods(HttpRequest::GET|HttpRequest::POST, req, res))
         return true;
-      bool ok = Qrond::instance()->loadConfig();
-      if (!ok)
-        res.set_status(HttpResponse::HTTP_Internal_Server_Error);
-      else
-        // wait to make it less probable that the page displays before effect
-        QThread::usleep(200'000);
-      apiAuditAndResponse(webconsole, req, res, context,
-                          ok ? "S:Configuration reloaded."
-                             : "E:Cannot reload configuration.",
+      auto userid = context.paramUtf16("userid"_u8);
+      if (req.query_param("wait"_u8) != "true"_u8) {
+        // parsing is done in background, the actual result is audited once
+        // done and errors will be in the logs
+        Qrond::instance()->asyncLoadConfig(userid);
+        apiAuditAndResponse(webconsole, req, res, context,
+                            "S:Configuration reload requested.",
+                            req.method_name()+" "+req.path().left(ml));
+        return true;
+      }
+      // parsing is done by this http worker thread, main thread only waited
+      // for during activation
+      QString message;
+      switch (Qrond::instance()->systemTriggeredLoadConfig(userid)) {
+      case Qrond::ConfigLoadActivated:
+        message = "S:Configuration reloaded.";
+        break;
+      case Qrond::ConfigLoadSuperseded:
+        message = "S:Configuration reloaded, but superseded by a more recent "
+                  "reload.";
+        break;
+      case Qrond::ConfigLoadFailed:
+        message = "E:Cannot reload configuration.";
+      }
+      apiAuditAndResponse(webconsole, req, res, context, message,
                           req.method_name()+" "+req.path().left(ml));
       return true;
     }, true },
@@ -1277,11 +1289,10 @@ static RadixTree<HandlerFunction> _handlers {
       ParamSet ps;
       ps.insert("pfconfig"_u8, pfconfig);
       Utf8String last_instances;
-      int lastinstancesdepth =
-          webconsole->scheduler()->globalParams().paramNumber<int>(
-            "webconsole.htmltables.lastinstancesdepth", 10);
-      for (auto instance:
-           webconsole->scheduler()->lastInstancesByTaskId(taskId, lastinstancesdepth)) {
+      int lastinstancesdepth = webconsole->taskInstancesIndex()->depth();
+      QSet<Utf8String> ids;
+      for (auto instance: webconsole->taskInstancesIndex()
+           ->lastInstancesByTaskId(taskId, lastinstancesdepth)) {
         last_instances += instance.id()+' ';
         ps.insert(instance.id()+":status"_u8, instance.statusAsString());
         ps.insert(instance.id()+":creation_date"_u8,
@@ -1290,6 +1301,29 @@ static RadixTree<HandlerFunction> _handlers {
                   instance.finishDatetime().toString());
         if (instance.startDatetime().isValid())
           ps.insert(instance.id()+":duration"_u8, instance.durationMillis()/1e3);
+        ids.insert(instance.id());
+      }
+      // complete with instances older than qrond startup, if any
+      auto journal = webconsole->taskInstanceJournal();
+      if (journal && ids.size() < lastinstancesdepth) {
+        for (auto record:
+             journal->lastRecordsByTaskId(taskId, lastinstancesdepth)) {
+          if (ids.size() >= lastinstancesdepth)
+            break;
+          auto id = Utf8String::number(record.id);
+          if (ids.contains(id))
+            continue;
+          last_instances += id+' ';
+          // no longer known to the scheduler, hence no task instance page
+          ps.insert(id+":journaled"_u8, "1"_u8);
+          ps.insert(id+":status"_u8, record.status);
+          ps.insert(id+":creation_date"_u8,
+                    record.creationDatetime().toString());
+          ps.insert(id+":finish_date"_u8, record.finishDatetime().toString());
+          if (record.start)
+            ps.insert(id+":duration"_u8, record.durationMillis()/1e3);
+          ids.insert(id);
+        }
       }
       last_instances.chop(1);
       ps.insert("last_instances"_u8,last_instances);
@@ -1331,7 +1365,9 @@ static RadixTree<HandlerFunction> _handlers {
       auto tii = elements.value(0).toULongLong();
       auto referer = req.header(
                        "Referer"_u8, context.paramUtf8("!pathtoroot"));
-      auto instance = webconsole->scheduler()->taskInstanceById(tii);
+      auto instance = webconsole->taskInstancesIndex()->taskInstanceById(tii);
+      if (!instance) // not among recent instances of its task
+        instance = webconsole->scheduler()->taskInstanceById(tii);
       if (!instance) {
         if (referer.isEmpty()) {
           res.set_status(404);
@@ -1752,16 +1788,16 @@ static RadixTree<HandlerFunction> _handlers {
     [](WebConsole *webconsole, HttpRequest &req, HttpResponse &res, ParamsProviderMerger &, int) STATIC_LAMBDA -> bool {
       if (!enforceMethods(HttpRequest::GET|HttpRequest::HEAD, req, res))
         return true;
-      return sortAndWriteItemsAsCsv(
-            webconsole->scheduler()->unfinishedTaskInstances().values(),
+      return writeItemsAsCsv(
+            webconsole->taskInstancesIndex()->unfinishedTaskInstances(),
             req, res);
     } },
   { "/rest/v1/taskinstances/current/list.html",
     [](WebConsole *webconsole, HttpRequest &req, HttpResponse &res, ParamsProviderMerger &, int) STATIC_LAMBDA -> bool {
       if (!enforceMethods(HttpRequest::GET|HttpRequest::HEAD, req, res))
         return true;
-      return sortAndWriteItemsAsHtmlTable(
-            webconsole->scheduler()->unfinishedTaskInstances().values(),
+      return writeItemsAsHtmlTable(
+            webconsole->taskInstancesIndex()->unfinishedTaskInstances(),
             req, res);
     } },
   { "/rest/v1/taskinstances/",
@@ -1826,6 +1862,38 @@ static RadixTree<HandlerFunction> _handlers {
         }
         return writePlainText(svg, req, res, SVG_MIME_TYPE);
       }
+      if (second == "herd_summary.csv"_u8) {
+        const auto tii = params.value(0).toNumber<quint64>();
+        auto index = webconsole->taskInstancesIndex();
+        auto herdid = index->taskInstanceById(tii).herdid();
+        auto herd = index->herdSummary(herdid ? herdid : tii);
+        if (herd.isNull()) {
+          res.set_status(404);
+          res.output()->write("Herd not found.");
+          return true;
+        }
+        static const QList<Utf8String> statuses {
+          "planned", "queued", "running", "waiting", "success", "failure",
+          "canceled" };
+        auto datetime = [](qint64 msecs) {
+          return msecs ? QDateTime::fromMSecsSinceEpoch(msecs)
+                         .toString(Qt::ISODateWithMs) : QString();
+        };
+        auto row = QString::number(herd.herdid);
+        TextMatrixModel model;
+        model.setCellValue(row, "herdid", row);
+        model.setCellValue(row, "members",
+                           QString::number(herd.members.size()));
+        model.setCellValue(row, "unfinished",
+                           QString::number(herd.unfinishedCount));
+        for (auto status: statuses)
+          model.setCellValue(row, status, QString::number(
+                               herd.statusCounts.value(status)));
+        model.setCellValue(row, "firststart", datetime(herd.firstStart));
+        model.setCellValue(row, "lastfinish", datetime(herd.lastFinish));
+        auto data = _csvFormatter.formatTable(&model).toUtf8();
+        return writePlainText(data, req, res, "text/csv;charset=UTF-8"_ba);
+      }
       res.set_base64_session_cookie("message", "E:Service '"+path // FIXME
                                     +"' not found.", "/");
       res.redirect(referer);
@@ -2052,6 +2120,12 @@ void WebConsole::setScheduler(Scheduler *scheduler) {
     connect(_scheduler->alerter(), &Alerter::configChanged,
             this, &WebConsole::alerterConfigChanged);
     _taskInstancesHistoryModel->setDocumentManager(scheduler);
+    // queued: index maintenance must not slow down the scheduler thread
+    connect(_scheduler, &Scheduler::itemChanged,
+            _taskInstancesIndex, &TaskInstancesIndex::changeItem,
+            Qt::QueuedConnection);
+    _taskInstancesIndex->setUnfinishedTaskInstances(
+          _scheduler->unfinishedTaskInstances().values());
     _unfinishedTaskInstancesModel->setDocumentManager(scheduler);
     _calendarsModel->setDocumentManager(scheduler);
     _taskGroupsModel->setDocumentManager(scheduler);
@@ -2175,6 +2249,11 @@ void WebConsole::paramsChanged(
       newParams.paramRawUtf16("webconsole.customactions.instanceslist");
   _unfinishedTaskInstancesModel->setCustomActions(customactions_instanceslist);
   _taskInstancesHistoryModel->setCustomActions(customactions_instanceslist);
+  int lastInstancesDepth = newParams.paramNumber<int>(
+        "webconsole.htmltables.lastinstancesdepth", 10);
+  _taskInstancesIndex->setDepth(lastInstancesDepth);
+  if (auto journal = taskInstanceJournal())
+    journal->setDepth(lastInstancesDepth);
   int rowsPerPage = newParams.paramNumber<int>(
         "webconsole.htmltables.rowsperpage", 100);
   int cachedRows = newParams.paramNumber<int>(
@@ -40,9 +40,12 @@
 #include "ui/confighistorymodel.h"
 #include "thread/atomicvalue.h"
 #include <QRegularExpression>
+#include <QAtomicPointer>
 #include "modelview/shareduiitemslogmodel.h"
 #include <QSortFilterProxyModel>
 #include "io/readonlyresourcescache.h"
+#include "sched/taskinstancejournal.h"
+#include "sched/taskinstancesindex.h"
 
 class QThread;
 
@@ -120,6 +123,8 @@ class WebConsole : public HttpHandler, public ParamsProvider {
   _showAuditUser, _hideAuditUser;
   AtomicValue<AlerterConfig> _alerterConfig;
   ReadOnlyResourcesCache *_readOnlyResourcesCache;
+  QAtomicPointer<TaskInstanceJournal> _taskInstanceJournal;
+  TaskInstancesIndex *_taskInstancesIndex;
 
 public:
   WebConsole();
@@ -131,6 +136,9 @@ public:
   void setConfigPaths(QString configFilePath, QString configRepoPath);
   void setConfigRepository(ConfigRepository *configRepository);
   void setAuthorizer(InMemoryRulesAuthorizer *authorizer);
+  /** This method is thread-safe. */
+  void setTaskInstanceJournal(TaskInstanceJournal *journal) {
+    _taskInstanceJournal.storeRelease(journal); }
   Scheduler *scheduler() const { return _scheduler; }
   ConfigRepository *configRepository() const { return _configRepository; }
   GraphvizImageHttpHandler *tasksDeploymentDiagram() const {
@@ -227,6 +235,10 @@ public:
   QString configRepoPath() const { return _configRepoPath; }
   ReadOnlyResourcesCache *readOnlyResourcesCache() const {
     return _readOnlyResourcesCache; }
+  TaskInstanceJournal *taskInstanceJournal() const {
+    return _taskInstanceJournal.loadAcquire(); }
+  TaskInstancesIndex *taskInstancesIndex() const {
+    return _taskInstancesIndex; }
   TypedValue paramRawValue(const Utf8String &key, const TypedValue &def,
                          const EvalContext &context) const override;
   Utf8StringSet paramKeys(const EvalContext &context) const override;